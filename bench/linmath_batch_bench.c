@@ -0,0 +1,178 @@
+/*
+ * linmath.h scalar loops against the linmath_batch.h kernels, once per
+ * backend available on this machine.
+ *
+ *   cmake -DPOTI_BENCH=ON ... && ./bin/linmath_batch_bench [count] [iterations]
+ *   cc -O2 -Iexternal bench/linmath_batch_bench.c -o linmath_batch_bench -lm
+ *
+ * Build with -DLINMATH_BATCH_NO_SIMD to only have the scalar batch path.
+ */
+#define _POSIX_C_SOURCE 199309L
+#define LINMATH_BATCH_IMPLEMENTATION
+#include "linmath_batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now(void) {
+#ifdef _WIN32
+    return (double)clock() / CLOCKS_PER_SEC;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+static float frand(void) {
+    return (float)rand() / RAND_MAX * 200.f - 100.f;
+}
+
+static int differs(float const *a, float const *b, int n) {
+    int i;
+    for (i = 0; i < n; i++) {
+        float d = a[i] - b[i];
+        float m = fabsf(a[i]) > 1.f ? fabsf(a[i]) : 1.f;
+        if (fabsf(d) > 1e-4f * m) return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static const char *backends[] = { "scalar", "sse2", "avx2", "neon" };
+    int count = argc > 1 ? atoi(argv[1]) : 100000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 100;
+    /* transform hierarchy: a chain of depth 8 repeated */
+    int nodes = count / 16;
+    vec4 *in4, *ref4, *out4;
+    vec2 *in2, *ref2, *out2;
+    mat4x4 *local, *ref_world, *world;
+    int *parent;
+    float *p[6], *q[6];
+    mat4x4 M;
+    double t0, ref_vec4, ref_vec2, ref_mul, ref_int;
+    int i, j, k, failed = 0;
+
+    if (count <= 0) count = 100000;
+    if (iterations <= 0) iterations = 100;
+    if (nodes < 1) nodes = 1;
+
+    in4 = malloc(count * sizeof(vec4));
+    ref4 = malloc(count * sizeof(vec4));
+    out4 = malloc(count * sizeof(vec4));
+    in2 = malloc(count * sizeof(vec2));
+    ref2 = malloc(count * sizeof(vec2));
+    out2 = malloc(count * sizeof(vec2));
+    local = malloc(nodes * sizeof(mat4x4));
+    ref_world = malloc(nodes * sizeof(mat4x4));
+    world = malloc(nodes * sizeof(mat4x4));
+    parent = malloc(nodes * sizeof(int));
+    for (k = 0; k < 6; k++) {
+        p[k] = malloc(count * sizeof(float));
+        q[k] = malloc(count * sizeof(float));
+    }
+
+    srand(1);
+    mat4x4_identity(M);
+    mat4x4_translate_in_place(M, 3.f, -2.f, 1.f);
+    mat4x4_rotate_Z(M, M, 0.3f);
+    mat4x4_scale_aniso(M, M, 2.f, 0.5f, 1.f);
+    for (i = 0; i < count; i++) {
+        in4[i][0] = frand(); in4[i][1] = frand(); in4[i][2] = frand(); in4[i][3] = 1.f;
+        in2[i][0] = in4[i][0]; in2[i][1] = in4[i][1];
+    }
+    for (i = 0; i < nodes; i++) {
+        mat4x4_translate(local[i], frand() * 0.01f, frand() * 0.01f, 0.f);
+        mat4x4_rotate_Z(local[i], local[i], frand() * 0.01f);
+        parent[i] = i % 8 ? i - 1 : -1;
+    }
+
+    /* scalar linmath.h reference */
+    t0 = now();
+    for (k = 0; k < iterations; k++)
+        for (i = 0; i < count; i++) mat4x4_mul_vec4(ref4[i], M, in4[i]);
+    ref_vec4 = now() - t0;
+
+    t0 = now();
+    for (k = 0; k < iterations; k++) {
+        for (i = 0; i < count; i++) {
+            vec4 v = { in2[i][0], in2[i][1], 0.f, 1.f };
+            vec4 r;
+            mat4x4_mul_vec4(r, M, v);
+            ref2[i][0] = r[0];
+            ref2[i][1] = r[1];
+        }
+    }
+    ref_vec2 = now() - t0;
+
+    t0 = now();
+    for (k = 0; k < iterations; k++) {
+        for (i = 0; i < nodes; i++) {
+            if (parent[i] < 0) mat4x4_dup(ref_world[i], local[i]);
+            else mat4x4_mul(ref_world[i], ref_world[parent[i]], local[i]);
+        }
+    }
+    ref_mul = now() - t0;
+
+    for (j = 0; j < 6; j++)
+        for (i = 0; i < count; i++) q[j][i] = j < 4 ? 0.f : frand();
+    t0 = now();
+    for (k = 0; k < iterations; k++) {
+        for (i = 0; i < count; i++) {
+            q[2][i] += q[4][i] * 0.016f;
+            q[3][i] += q[5][i] * 0.016f;
+            q[0][i] += q[2][i] * 0.016f;
+            q[1][i] += q[3][i] * 0.016f;
+        }
+    }
+    ref_int = now() - t0;
+
+    printf("%d elements, %d hierarchy nodes, %d iterations\n", count, nodes, iterations);
+    printf("%-8s %12s %12s %12s %12s\n", "", "vec4", "vec2", "compose", "integrate");
+    printf("%-8s %10.2fms %10.2fms %10.2fms %10.2fms\n", "linmath",
+           ref_vec4 * 1e3, ref_vec2 * 1e3, ref_mul * 1e3, ref_int * 1e3);
+
+    for (j = 0; j < (int)(sizeof(backends) / sizeof(backends[0])); j++) {
+        double t_vec4, t_vec2, t_mul, t_int;
+        if (!linmath_batch_init(backends[j])) continue;
+
+        t0 = now();
+        for (k = 0; k < iterations; k++) mat4x4_mul_vec4_batch(out4, (vec4 const*)M, (vec4 const*)in4, count);
+        t_vec4 = now() - t0;
+
+        t0 = now();
+        for (k = 0; k < iterations; k++) mat4x4_mul_vec2_batch(out2, (vec4 const*)M, (vec2 const*)in2, count);
+        t_vec2 = now() - t0;
+
+        t0 = now();
+        for (k = 0; k < iterations; k++) mat4x4_compose_batch(world, (mat4x4 const*)local, parent, nodes);
+        t_mul = now() - t0;
+
+        for (k = 0; k < 6; k++)
+            for (i = 0; i < count; i++) p[k][i] = k < 4 ? 0.f : q[k][i];
+        t0 = now();
+        for (k = 0; k < iterations; k++) vec2_integrate_soa(p[0], p[1], p[2], p[3], p[4], p[5], 0.016f, count);
+        t_int = now() - t0;
+
+        printf("%-8s %10.2fms %10.2fms %10.2fms %10.2fms\n", linmath_batch_backend(),
+               t_vec4 * 1e3, t_vec2 * 1e3, t_mul * 1e3, t_int * 1e3);
+
+        if (differs(ref4[0], out4[0], count * 4) ||
+            differs(ref2[0], out2[0], count * 2) ||
+            differs(ref_world[0][0], world[0][0], nodes * 16) ||
+            differs(q[0], p[0], count) || differs(q[1], p[1], count)) {
+            fprintf(stderr, "%s: results differ from linmath.h\n", backends[j]);
+            failed = 1;
+        }
+    }
+
+    for (k = 0; k < 6; k++) {
+        free(p[k]);
+        free(q[k]);
+    }
+    free(in4); free(ref4); free(out4);
+    free(in2); free(ref2); free(out2);
+    free(local); free(ref_world); free(world); free(parent);
+    return failed;
+}
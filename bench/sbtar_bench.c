@@ -0,0 +1,177 @@
+/*
+ * Open/lookup timings for sabotar.h: the linear sbtar_open path against
+ * the indexed sbtar_load path.
+ *
+ *   cmake -DPOTI_BENCH=ON ... && ./bin/sbtar_bench [entries] [file]
+ *   cc -O2 -Iexternal bench/sbtar_bench.c -o sbtar_bench
+ *
+ * Build with -DSBTAR_NO_MMAP to time the stdio fallback of sbtar_load.
+ */
+#define _POSIX_C_SOURCE 199309L
+#define SBTAR_IMPLEMENTATION
+#include "sabotar.h"
+
+#include <time.h>
+
+static double now(void) {
+#ifdef _WIN32
+    return (double)clock() / CLOCKS_PER_SEC;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+/* writes one entry in the same layout sbtar_write produces */
+static void write_entry(FILE *fp, const char *name, const char *data, unsigned size) {
+    posix_header_t p;
+    char block[SBTAR_BLOCK_SIZE];
+    unsigned char *bytes = (unsigned char*)&p;
+    unsigned sum = 0;
+    unsigned i, blocks;
+    size_t len = strlen(name);
+
+    memset(&p, 0, sizeof(p));
+    /* a 100 character name fills the field with no NUL, like GNU tar */
+    memcpy(p.name, name, len < sizeof(p.name) ? len : sizeof(p.name));
+    memcpy(p.mode, "0000644", 7);
+    memcpy(p.uid, "0001750", 7);
+    memcpy(p.gid, "0001750", 7);
+    sprintf(p.size, "%.11o", size);
+    sprintf(p.mtime, "%.11o", 0u);
+    p.typeflag = '0';
+    memcpy(p.magic, "ustar ", 6);
+    p.version[0] = ' ';
+    memset(p.chksum, ' ', sizeof(p.chksum));
+    for (i = 0; i < SBTAR_BLOCK_SIZE; i++) sum += bytes[i];
+    sprintf(p.chksum, "%.6o", sum);
+    fwrite(&p, 1, SBTAR_BLOCK_SIZE, fp);
+
+    memset(block, 0, sizeof(block));
+    blocks = (1 + size/SBTAR_BLOCK_SIZE) + (size != 0);
+    fwrite(data, 1, size, fp);
+    fwrite(block, 1, blocks * SBTAR_BLOCK_SIZE - SBTAR_BLOCK_SIZE - size, fp);
+}
+
+static void generate(const char *path, int entries) {
+    FILE *fp = fopen(path, "wb");
+    char name[64], data[64];
+    char block[SBTAR_BLOCK_SIZE];
+    int i;
+    if (!fp) {
+        fprintf(stderr, "Failed to create %s\n", path);
+        exit(1);
+    }
+    for (i = 0; i < entries; i++) {
+        sprintf(name, "assets/file%05d.txt", i);
+        sprintf(data, "content of entry %d\n", i);
+        write_entry(fp, name, data, strlen(data));
+    }
+    memset(block, 0, sizeof(block));
+    fwrite(block, 1, SBTAR_BLOCK_SIZE, fp);
+    fwrite(block, 1, SBTAR_BLOCK_SIZE, fp);
+    fclose(fp);
+}
+
+/* the index must keep names that use the whole 100 byte field */
+static int check_long_name(const char *path) {
+    FILE *fp = fopen(path, "wb");
+    char name[128], block[SBTAR_BLOCK_SIZE];
+    sbtar_t tar;
+    int i, failed = 0;
+    if (!fp) {
+        fprintf(stderr, "Failed to create %s\n", path);
+        exit(1);
+    }
+    for (i = 0; i < 63; i++) {
+        sprintf(name, "small%02d.txt", i);
+        write_entry(fp, name, name, strlen(name));
+    }
+    memset(name, 'x', 100);
+    name[100] = '\0';
+    write_entry(fp, name, "long", 4);
+    memset(block, 0, sizeof(block));
+    fwrite(block, 1, SBTAR_BLOCK_SIZE, fp);
+    fwrite(block, 1, SBTAR_BLOCK_SIZE, fp);
+    fclose(fp);
+
+    sbtar_load(&tar, path);
+    for (i = 0; i < 63; i++) {
+        sprintf(name, "small%02d.txt", i);
+        const char *data = sbtar_read(&tar, name);
+        if (!data || strcmp(data, name)) failed++;
+        free((void*)data);
+    }
+    memset(name, 'x', 100);
+    name[100] = '\0';
+    const char *data = sbtar_read(&tar, name);
+    if (!data || strcmp(data, "long")) failed++;
+    free((void*)data);
+    sbtar_close(&tar);
+    remove(path);
+
+    if (failed) fprintf(stderr, "long name check: %d lookups failed\n", failed);
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    int entries = argc > 1 ? atoi(argv[1]) : 10000;
+    const char *path = argc > 2 ? argv[2] : "sbtar_bench.tar";
+    /* the linear path is O(n) per lookup, so only sample it */
+    int step = entries > 100 ? entries / 100 : 1;
+    int linear = 0, missing = 0;
+    char name[64];
+    sbtar_t tar;
+    double t0, t1;
+    int i;
+
+    if (entries <= 0) entries = 10000;
+    generate(path, entries);
+
+    t0 = now();
+    sbtar_open(&tar, path);
+    t1 = now();
+    printf("sbtar_open:  %10.3f ms\n", (t1 - t0) * 1e3);
+    t0 = now();
+    for (i = 0; i < entries; i += step, linear++) {
+        sprintf(name, "assets/file%05d.txt", i);
+        const char *data = sbtar_read(&tar, name);
+        if (!data) missing++;
+        free((void*)data);
+    }
+    t1 = now();
+    printf("  linear sbtar_read: %10.3f us/lookup (%d lookups)\n", (t1 - t0) * 1e6 / linear, linear);
+    sbtar_close(&tar);
+
+    t0 = now();
+    sbtar_load(&tar, path);
+    t1 = now();
+    printf("sbtar_load:  %10.3f ms (%u entries, %s)\n", (t1 - t0) * 1e3, tar.count, tar.map ? "mmap" : "stdio");
+    t0 = now();
+    for (i = 0; i < entries; i++) {
+        sprintf(name, "assets/file%05d.txt", i);
+        const char *data = sbtar_read(&tar, name);
+        if (!data) missing++;
+        free((void*)data);
+    }
+    t1 = now();
+    printf("  indexed sbtar_read: %10.3f us/lookup (%d lookups)\n", (t1 - t0) * 1e6 / entries, entries);
+    if (tar.map) {
+        t0 = now();
+        for (i = 0; i < entries; i++) {
+            unsigned size;
+            sprintf(name, "assets/file%05d.txt", i);
+            if (!sbtar_view(&tar, name, &size)) missing++;
+        }
+        t1 = now();
+        printf("  sbtar_view:         %10.3f us/lookup (%d lookups)\n", (t1 - t0) * 1e6 / entries, entries);
+    }
+    sbtar_close(&tar);
+    remove(path);
+
+    missing += check_long_name(path);
+
+    if (missing) fprintf(stderr, "%d lookups failed\n", missing);
+    return missing != 0;
+}
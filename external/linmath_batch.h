@@ -0,0 +1,359 @@
+#ifndef LINMATH_BATCH_H
+#define LINMATH_BATCH_H
+
+/*
+ * Array versions of the hot linmath.h routines. Every function has a
+ * scalar path; SSE2/AVX2 (x86) or NEON (arm) paths are picked at runtime
+ * on the first call, or by linmath_batch_init. Define
+ * LINMATH_BATCH_NO_SIMD to only build the scalar code.
+ *
+ * Include with LINMATH_BATCH_IMPLEMENTATION defined in one C file.
+ */
+
+#include "linmath.h"
+
+#define LINMATH_BATCH_API extern
+
+/* r[i] = M * (v[i].x, v[i].y, 0, 1), keeping x and y */
+LINMATH_BATCH_API void mat4x4_mul_vec2_batch(vec2 *r, mat4x4 const M, vec2 const *v, int count);
+/* r[i] = M * v[i] */
+LINMATH_BATCH_API void mat4x4_mul_vec4_batch(vec4 *r, mat4x4 const M, vec4 const *v, int count);
+/*
+ * Flattens a transform hierarchy: R[i] = R[parent[i]] * local[i], or
+ * local[i] when parent[i] < 0. Parents must come before their children.
+ */
+LINMATH_BATCH_API void mat4x4_compose_batch(mat4x4 *R, mat4x4 const *local, int const *parent, int count);
+/* semi-implicit euler over SoA arrays: v += a*dt; p += v*dt */
+LINMATH_BATCH_API void vec2_integrate_soa(float *x, float *y, float *vx, float *vy, float const *ax, float const *ay, float dt, int count);
+
+/*
+ * Selects the kernels by name ("scalar", "sse2", "avx2", "neon"), or the
+ * fastest available one when backend is NULL. Returns 0 and keeps the
+ * current selection if the backend isn't available on this machine.
+ * Without GCC/Clang/MSVC atomics, call it once before using the batch
+ * functions from several threads.
+ */
+LINMATH_BATCH_API int linmath_batch_init(const char *backend);
+LINMATH_BATCH_API const char* linmath_batch_backend(void);
+
+#endif /* LINMATH_BATCH_H */
+
+#ifdef LINMATH_BATCH_IMPLEMENTATION
+
+#ifndef LINMATH_BATCH_NO_SIMD
+	#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#define LINMATH_BATCH_SSE2
+		#include <emmintrin.h>
+		#if (defined(__GNUC__) || defined(__clang__)) && !defined(__EMSCRIPTEN__)
+			#define LINMATH_BATCH_AVX2
+			#include <immintrin.h>
+		#endif
+	#endif
+	#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+		#define LINMATH_BATCH_NEON
+		#include <arm_neon.h>
+	#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+	#define LINMATH_BATCH_LOAD(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+	#define LINMATH_BATCH_STORE(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+#elif defined(_MSC_VER)
+	#include <intrin.h>
+	#define LINMATH_BATCH_LOAD(p) ((linmath_batch_t const*)_InterlockedCompareExchangePointer((void* volatile*)&(p), NULL, NULL))
+	#define LINMATH_BATCH_STORE(p, v) _InterlockedExchangePointer((void* volatile*)&(p), (void*)(v))
+#else
+	#define LINMATH_BATCH_LOAD(p) (p)
+	#define LINMATH_BATCH_STORE(p, v) ((p) = (v))
+#endif
+
+typedef struct {
+	const char *name;
+	void (*vec2)(vec2 *r, mat4x4 const M, vec2 const *v, int count);
+	void (*vec4)(vec4 *r, mat4x4 const M, vec4 const *v, int count);
+	void (*integrate)(float *x, float *y, float *vx, float *vy, float const *ax, float const *ay, float dt, int count);
+} linmath_batch_t;
+
+/* points at one of the const tables below, published with a single store */
+static linmath_batch_t const *_lmb;
+
+/* scalar */
+
+static void _vec2_scalar(vec2 *r, mat4x4 const M, vec2 const *v, int count)
+{
+	int i;
+	for(i=0; i<count; ++i) {
+		float x = v[i][0], y = v[i][1];
+		r[i][0] = M[0][0]*x + M[1][0]*y + M[3][0];
+		r[i][1] = M[0][1]*x + M[1][1]*y + M[3][1];
+	}
+}
+
+static void _vec4_scalar(vec4 *r, mat4x4 const M, vec4 const *v, int count)
+{
+	int i, j;
+	for(i=0; i<count; ++i) {
+		vec4 t;
+		vec4_dup(t, v[i]);
+		for(j=0; j<4; ++j)
+			r[i][j] = M[0][j]*t[0] + M[1][j]*t[1] + M[2][j]*t[2] + M[3][j]*t[3];
+	}
+}
+
+static void _integrate_scalar(float *x, float *y, float *vx, float *vy, float const *ax, float const *ay, float dt, int count)
+{
+	int i;
+	for(i=0; i<count; ++i) {
+		vx[i] += ax[i]*dt;
+		vy[i] += ay[i]*dt;
+		x[i] += vx[i]*dt;
+		y[i] += vy[i]*dt;
+	}
+}
+
+#ifdef LINMATH_BATCH_SSE2
+
+static void _vec2_sse2(vec2 *r, mat4x4 const M, vec2 const *v, int count)
+{
+	/* two vec2 per register: x0 y0 x1 y1 */
+	__m128 cx = _mm_setr_ps(M[0][0], M[0][1], M[0][0], M[0][1]);
+	__m128 cy = _mm_setr_ps(M[1][0], M[1][1], M[1][0], M[1][1]);
+	__m128 ct = _mm_setr_ps(M[3][0], M[3][1], M[3][0], M[3][1]);
+	int i;
+	for(i=0; i+2<=count; i+=2) {
+		__m128 p = _mm_loadu_ps(v[i]);
+		__m128 xs = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+		__m128 ys = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+		__m128 o = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, xs), _mm_mul_ps(cy, ys)), ct);
+		_mm_storeu_ps(r[i], o);
+	}
+	_vec2_scalar(r + i, M, v + i, count - i);
+}
+
+static void _vec4_sse2(vec4 *r, mat4x4 const M, vec4 const *v, int count)
+{
+	__m128 c0 = _mm_loadu_ps(M[0]);
+	__m128 c1 = _mm_loadu_ps(M[1]);
+	__m128 c2 = _mm_loadu_ps(M[2]);
+	__m128 c3 = _mm_loadu_ps(M[3]);
+	int i;
+	for(i=0; i<count; ++i) {
+		__m128 p = _mm_loadu_ps(v[i]);
+		__m128 o = _mm_mul_ps(c0, _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0)));
+		o = _mm_add_ps(o, _mm_mul_ps(c1, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1))));
+		o = _mm_add_ps(o, _mm_mul_ps(c2, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2))));
+		o = _mm_add_ps(o, _mm_mul_ps(c3, _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3))));
+		_mm_storeu_ps(r[i], o);
+	}
+}
+
+static void _integrate_sse2(float *x, float *y, float *vx, float *vy, float const *ax, float const *ay, float dt, int count)
+{
+	__m128 d = _mm_set1_ps(dt);
+	int i;
+	for(i=0; i+4<=count; i+=4) {
+		__m128 nvx = _mm_add_ps(_mm_loadu_ps(vx + i), _mm_mul_ps(_mm_loadu_ps(ax + i), d));
+		__m128 nvy = _mm_add_ps(_mm_loadu_ps(vy + i), _mm_mul_ps(_mm_loadu_ps(ay + i), d));
+		_mm_storeu_ps(vx + i, nvx);
+		_mm_storeu_ps(vy + i, nvy);
+		_mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(nvx, d)));
+		_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(nvy, d)));
+	}
+	_integrate_scalar(x + i, y + i, vx + i, vy + i, ax + i, ay + i, dt, count - i);
+}
+
+#endif /* LINMATH_BATCH_SSE2 */
+
+#ifdef LINMATH_BATCH_AVX2
+
+#define LINMATH_BATCH_TARGET __attribute__((target("avx2")))
+
+LINMATH_BATCH_TARGET static void _vec2_avx2(vec2 *r, mat4x4 const M, vec2 const *v, int count)
+{
+	/* four vec2 per register, same lane layout as the sse2 path */
+	__m256 cx = _mm256_setr_ps(M[0][0], M[0][1], M[0][0], M[0][1], M[0][0], M[0][1], M[0][0], M[0][1]);
+	__m256 cy = _mm256_setr_ps(M[1][0], M[1][1], M[1][0], M[1][1], M[1][0], M[1][1], M[1][0], M[1][1]);
+	__m256 ct = _mm256_setr_ps(M[3][0], M[3][1], M[3][0], M[3][1], M[3][0], M[3][1], M[3][0], M[3][1]);
+	int i;
+	for(i=0; i+4<=count; i+=4) {
+		__m256 p = _mm256_loadu_ps(v[i]);
+		__m256 xs = _mm256_permute_ps(p, _MM_SHUFFLE(2, 2, 0, 0));
+		__m256 ys = _mm256_permute_ps(p, _MM_SHUFFLE(3, 3, 1, 1));
+		__m256 o = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, xs), _mm256_mul_ps(cy, ys)), ct);
+		_mm256_storeu_ps(r[i], o);
+	}
+	/* leave the upper halves clean before running legacy sse code */
+	_mm256_zeroupper();
+	_vec2_sse2(r + i, M, v + i, count - i);
+}
+
+LINMATH_BATCH_TARGET static void _vec4_avx2(vec4 *r, mat4x4 const M, vec4 const *v, int count)
+{
+	/* two vec4 per register, each 128-bit lane holds one vector */
+	__m256 c0 = _mm256_broadcast_ps((__m128 const*)M[0]);
+	__m256 c1 = _mm256_broadcast_ps((__m128 const*)M[1]);
+	__m256 c2 = _mm256_broadcast_ps((__m128 const*)M[2]);
+	__m256 c3 = _mm256_broadcast_ps((__m128 const*)M[3]);
+	int i;
+	for(i=0; i+2<=count; i+=2) {
+		__m256 p = _mm256_loadu_ps(v[i]);
+		__m256 o = _mm256_mul_ps(c0, _mm256_permute_ps(p, _MM_SHUFFLE(0, 0, 0, 0)));
+		o = _mm256_add_ps(o, _mm256_mul_ps(c1, _mm256_permute_ps(p, _MM_SHUFFLE(1, 1, 1, 1))));
+		o = _mm256_add_ps(o, _mm256_mul_ps(c2, _mm256_permute_ps(p, _MM_SHUFFLE(2, 2, 2, 2))));
+		o = _mm256_add_ps(o, _mm256_mul_ps(c3, _mm256_permute_ps(p, _MM_SHUFFLE(3, 3, 3, 3))));
+		_mm256_storeu_ps(r[i], o);
+	}
+	_mm256_zeroupper();
+	_vec4_sse2(r + i, M, v + i, count - i);
+}
+
+LINMATH_BATCH_TARGET static void _integrate_avx2(float *x, float *y, float *vx, float *vy, float const *ax, float const *ay, float dt, int count)
+{
+	__m256 d = _mm256_set1_ps(dt);
+	int i;
+	for(i=0; i+8<=count; i+=8) {
+		__m256 nvx = _mm256_add_ps(_mm256_loadu_ps(vx + i), _mm256_mul_ps(_mm256_loadu_ps(ax + i), d));
+		__m256 nvy = _mm256_add_ps(_mm256_loadu_ps(vy + i), _mm256_mul_ps(_mm256_loadu_ps(ay + i), d));
+		_mm256_storeu_ps(vx + i, nvx);
+		_mm256_storeu_ps(vy + i, nvy);
+		_mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(nvx, d)));
+		_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(nvy, d)));
+	}
+	_mm256_zeroupper();
+	_integrate_sse2(x + i, y + i, vx + i, vy + i, ax + i, ay + i, dt, count - i);
+}
+
+#endif /* LINMATH_BATCH_AVX2 */
+
+#ifdef LINMATH_BATCH_NEON
+
+static void _vec2_neon(vec2 *r, mat4x4 const M, vec2 const *v, int count)
+{
+	int i;
+	for(i=0; i+4<=count; i+=4) {
+		float32x4x2_t p = vld2q_f32(v[i]);
+		float32x4x2_t o;
+		o.val[0] = vaddq_f32(vdupq_n_f32(M[3][0]), vaddq_f32(vmulq_n_f32(p.val[0], M[0][0]), vmulq_n_f32(p.val[1], M[1][0])));
+		o.val[1] = vaddq_f32(vdupq_n_f32(M[3][1]), vaddq_f32(vmulq_n_f32(p.val[0], M[0][1]), vmulq_n_f32(p.val[1], M[1][1])));
+		vst2q_f32(r[i], o);
+	}
+	_vec2_scalar(r + i, M, v + i, count - i);
+}
+
+static void _vec4_neon(vec4 *r, mat4x4 const M, vec4 const *v, int count)
+{
+	float32x4_t c0 = vld1q_f32(M[0]);
+	float32x4_t c1 = vld1q_f32(M[1]);
+	float32x4_t c2 = vld1q_f32(M[2]);
+	float32x4_t c3 = vld1q_f32(M[3]);
+	int i;
+	for(i=0; i<count; ++i) {
+		float32x4_t p = vld1q_f32(v[i]);
+		float32x4_t o = vmulq_n_f32(c0, vgetq_lane_f32(p, 0));
+		o = vaddq_f32(o, vmulq_n_f32(c1, vgetq_lane_f32(p, 1)));
+		o = vaddq_f32(o, vmulq_n_f32(c2, vgetq_lane_f32(p, 2)));
+		o = vaddq_f32(o, vmulq_n_f32(c3, vgetq_lane_f32(p, 3)));
+		vst1q_f32(r[i], o);
+	}
+}
+
+static void _integrate_neon(float *x, float *y, float *vx, float *vy, float const *ax, float const *ay, float dt, int count)
+{
+	int i;
+	for(i=0; i+4<=count; i+=4) {
+		float32x4_t nvx = vaddq_f32(vld1q_f32(vx + i), vmulq_n_f32(vld1q_f32(ax + i), dt));
+		float32x4_t nvy = vaddq_f32(vld1q_f32(vy + i), vmulq_n_f32(vld1q_f32(ay + i), dt));
+		vst1q_f32(vx + i, nvx);
+		vst1q_f32(vy + i, nvy);
+		vst1q_f32(x + i, vaddq_f32(vld1q_f32(x + i), vmulq_n_f32(nvx, dt)));
+		vst1q_f32(y + i, vaddq_f32(vld1q_f32(y + i), vmulq_n_f32(nvy, dt)));
+	}
+	_integrate_scalar(x + i, y + i, vx + i, vy + i, ax + i, ay + i, dt, count - i);
+}
+
+#endif /* LINMATH_BATCH_NEON */
+
+static linmath_batch_t const _lmb_scalar = { "scalar", _vec2_scalar, _vec4_scalar, _integrate_scalar };
+#ifdef LINMATH_BATCH_SSE2
+static linmath_batch_t const _lmb_sse2 = { "sse2", _vec2_sse2, _vec4_sse2, _integrate_sse2 };
+#endif
+#ifdef LINMATH_BATCH_AVX2
+static linmath_batch_t const _lmb_avx2 = { "avx2", _vec2_avx2, _vec4_avx2, _integrate_avx2 };
+#endif
+#ifdef LINMATH_BATCH_NEON
+static linmath_batch_t const _lmb_neon = { "neon", _vec2_neon, _vec4_neon, _integrate_neon };
+#endif
+
+int linmath_batch_init(const char *backend)
+{
+	/* available backends, slowest first */
+	linmath_batch_t const *list[4];
+	int i, n = 0;
+	list[n++] = &_lmb_scalar;
+#ifdef LINMATH_BATCH_SSE2
+	list[n++] = &_lmb_sse2;
+#endif
+#ifdef LINMATH_BATCH_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		list[n++] = &_lmb_avx2;
+#endif
+#ifdef LINMATH_BATCH_NEON
+	list[n++] = &_lmb_neon;
+#endif
+	if (!backend) {
+		LINMATH_BATCH_STORE(_lmb, list[n-1]);
+		return 1;
+	}
+	for(i=0; i<n; ++i) {
+		if (!strcmp(list[i]->name, backend)) {
+			LINMATH_BATCH_STORE(_lmb, list[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* racing first calls all store the same table, so this is benign */
+static linmath_batch_t const* _lmb_get(void)
+{
+	linmath_batch_t const *b = LINMATH_BATCH_LOAD(_lmb);
+	if (!b) {
+		linmath_batch_init(NULL);
+		b = LINMATH_BATCH_LOAD(_lmb);
+	}
+	return b;
+}
+
+void mat4x4_mul_vec2_batch(vec2 *r, mat4x4 const M, vec2 const *v, int count)
+{
+	_lmb_get()->vec2(r, M, v, count);
+}
+
+void mat4x4_mul_vec4_batch(vec4 *r, mat4x4 const M, vec4 const *v, int count)
+{
+	_lmb_get()->vec4(r, M, v, count);
+}
+
+void mat4x4_compose_batch(mat4x4 *R, mat4x4 const *local, int const *parent, int count)
+{
+	linmath_batch_t const *b = _lmb_get();
+	int i;
+	for(i=0; i<count; ++i) {
+		if (parent[i] < 0) mat4x4_dup(R[i], local[i]);
+		/* each column of parent * local is parent * column */
+		else b->vec4(R[i], (vec4 const*)R[parent[i]], local[i], 4);
+	}
+}
+
+void vec2_integrate_soa(float *x, float *y, float *vx, float *vy, float const *ax, float const *ay, float dt, int count)
+{
+	_lmb_get()->integrate(x, y, vx, vy, ax, ay, dt, count);
+}
+
+const char* linmath_batch_backend(void)
+{
+	return _lmb_get()->name;
+}
+
+#endif /* LINMATH_BATCH_IMPLEMENTATION */
@@ -3,12 +3,20 @@
 
 #define SBTAR_API extern
 
-#define SBTAR_VERSION "0.2.0"
+#define SBTAR_VERSION "0.3.0"
 
 #ifndef SBTAR_MALLOC
     #define SBTAR_MALLOC malloc
 #endif
 
+#ifndef SBTAR_REALLOC
+    #define SBTAR_REALLOC realloc
+#endif
+
+#ifndef SBTAR_FREE
+    #define SBTAR_FREE free
+#endif
+
 #define STR(x) #x
 #define SBTAR_ASSERT(expr) \
 if (!(expr)) { \
@@ -56,6 +64,7 @@ enum {
 
 typedef struct sbtar_t sbtar_t;
 typedef struct sbtar_header_t sbtar_header_t;
+typedef struct sbtar_entry_t sbtar_entry_t;
 typedef struct posix_header_t posix_header_t;
 
 /* POSIX header */
@@ -81,11 +90,27 @@ struct posix_header_t {
     };                        /* 512 */
 };
 
+struct sbtar_entry_t {
+    unsigned hash;
+    unsigned offset;
+    unsigned size;
+    unsigned type;
+    /* tar names can use all 100 bytes without a NUL */
+    char name[101];
+};
+
 struct sbtar_t {
     unsigned offset;
     unsigned size;
 
     FILE *fp;
+
+    /* filled by sbtar_load only */
+    const char *map;
+    sbtar_entry_t *entries;
+    unsigned count;
+    unsigned *slots;
+    unsigned mask;
 };
 
 struct sbtar_header_t {
@@ -100,6 +125,13 @@ struct sbtar_header_t {
 };
 
 SBTAR_API void sbtar_open(sbtar_t *tar, const char *filename);
+/*
+ * Opens the tar read-only and indexes it once, so sbtar_find/sbtar_read
+ * don't need to walk the headers again. When mmap is available the file
+ * is also mapped and sbtar_view returns pointers straight into it.
+ * Define SBTAR_NO_MMAP to always use stdio.
+ */
+SBTAR_API void sbtar_load(sbtar_t *tar, const char *filename);
 SBTAR_API void sbtar_new(sbtar_t *tar, const char* filename);
 SBTAR_API void sbtar_close(sbtar_t *tar);
 
@@ -114,6 +146,8 @@ SBTAR_API void sbtar_data(sbtar_t *tar, void *buf, unsigned size);
 SBTAR_API void sbtar_ls(sbtar_t *tar);
 SBTAR_API int sbtar_find(sbtar_t *tar, const char *filename);
 
+SBTAR_API const sbtar_entry_t* sbtar_entry(sbtar_t *tar, const char *filename);
+SBTAR_API const char* sbtar_view(sbtar_t *tar, const char *filename, unsigned *size);
 SBTAR_API const char* sbtar_read(sbtar_t *tar, const char *filename);
 SBTAR_API void sbtar_write(sbtar_t *tar, const char *filename, const char *text, unsigned size);
 SBTAR_API void sbtar_write_dir(sbtar_t *tar, const char *dirname);
@@ -126,6 +160,13 @@ SBTAR_API void sbtar_write_dir(sbtar_t *tar, const char *dirname);
 #include <string.h>
 #include <time.h>
 
+#if !defined(SBTAR_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+    #define SBTAR_USE_MMAP
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+#endif
+
 #define USER_MODE_MASK    0x7
 #define GROUP_MODE_MASK  0x28
 #define OTHER_MODE_MASK 0x1C0
@@ -185,20 +226,144 @@ long _header_size(const posix_header_t *h) {
     return oct2int(bytes, SBTAR_SZ_SIZE);
 }
 
-void sbtar_open(sbtar_t *tar, const char *filename) {
+static void _parse_header(const posix_header_t *posix, sbtar_header_t *h) {
+    strcpy(h->name, posix->name);
+    strcpy(h->linkname, posix->linkname);
+    h->size = oct2int(posix->size, SBTAR_SZ_SIZE-1);
+    h->mtime = oct2int(posix->mtime, SBTAR_MTIME_SIZE-1);
+    h->type = posix->typeflag - '0';
+    h->mode = oct2int(posix->mode, 7);
+    h->chksum = oct2int(posix->chksum, 7);
+    strcpy(h->uname, posix->uname);
+    strcpy(h->gname, posix->gname);
+}
+
+/* distance from an entry header to the next one, same layout sbtar_write produces */
+static unsigned _entry_span(unsigned size) {
+    unsigned next = (1 + size/SBTAR_BLOCK_SIZE) * SBTAR_BLOCK_SIZE;
+    if (size != 0) next += SBTAR_BLOCK_SIZE;
+    return next;
+}
+
+/* FNV-1a */
+static unsigned _hash_name(const char *name) {
+    unsigned hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void _read_at(sbtar_t *tar, unsigned offset, void *buf, unsigned size) {
+    if (tar->map) {
+        memcpy(buf, tar->map + offset, size);
+        return;
+    }
+    fseek(tar->fp, offset, SEEK_SET);
+    fread(buf, size, 1, tar->fp);
+}
+
+static void _index_insert(sbtar_t *tar, unsigned index) {
+    unsigned hash = tar->entries[index].hash;
+    unsigned slot = hash & tar->mask;
+    while (tar->slots[slot]) {
+        sbtar_entry_t *e = tar->entries + tar->slots[slot] - 1;
+        /* keep the first match, like the linear sbtar_find */
+        if (e->hash == hash && !strcmp(e->name, tar->entries[index].name)) return;
+        slot = (slot + 1) & tar->mask;
+    }
+    tar->slots[slot] = index + 1;
+}
+
+static void _index_build(sbtar_t *tar) {
+    unsigned cap = 0;
+    unsigned offset = 0;
+    posix_header_t posix;
+    unsigned size, type;
+    unsigned i;
+
+    while (offset + SBTAR_BLOCK_SIZE <= tar->size) {
+        _read_at(tar, offset, &posix, SBTAR_BLOCK_SIZE);
+        if (oct2int(posix.chksum, 7) == 0) break;
+        size = oct2int(posix.size, SBTAR_SZ_SIZE-1);
+        type = posix.typeflag - '0';
+        /* truncated archive, the data would run past the end of the file */
+        if (size > tar->size - offset - SBTAR_BLOCK_SIZE) break;
+
+        if (tar->count == cap) {
+            cap = cap ? cap * 2 : 64;
+            tar->entries = SBTAR_REALLOC(tar->entries, cap * sizeof(sbtar_entry_t));
+            SBTAR_ASSERT(tar->entries != NULL);
+        }
+        sbtar_entry_t *e = tar->entries + tar->count++;
+        e->offset = offset;
+        e->size = size;
+        e->type = type;
+        memcpy(e->name, posix.name, sizeof(posix.name));
+        e->name[sizeof(posix.name)] = '\0';
+        e->hash = _hash_name(e->name);
+
+        /* same stop conditions as sbtar_next, a V7 '\0' typeflag ends the walk */
+        if ((int)type < 0) break;
+        if (offset + (1 + size/SBTAR_BLOCK_SIZE) * SBTAR_BLOCK_SIZE >= tar->size) break;
+        offset += _entry_span(size);
+    }
+
+    /* keep the table at most half full */
+    cap = 16;
+    while (cap < tar->count * 2) cap *= 2;
+    tar->mask = cap - 1;
+    tar->slots = SBTAR_MALLOC(cap * sizeof(unsigned));
+    SBTAR_ASSERT(tar->slots != NULL);
+    memset(tar->slots, 0, cap * sizeof(unsigned));
+    for (i = 0; i < tar->count; i++) _index_insert(tar, i);
+}
+
+static void _reset_index(sbtar_t *tar) {
+    tar->map = NULL;
+    tar->entries = NULL;
+    tar->count = 0;
+    tar->slots = NULL;
+    tar->mask = 0;
+}
+
+static void _open_tar(sbtar_t *tar, const char *filename, const char *mode) {
     SBTAR_ASSERT(tar != NULL);
 
-    tar->fp = fopen(filename, "rb+");
+    tar->fp = fopen(filename, mode);
     if (!tar->fp) {
         fprintf(stderr, "Failed to open %s\n", filename);
         exit(1);
     }
     tar->offset = 0;
+    _reset_index(tar);
     fseek(tar->fp, 0, SEEK_END);
     tar->size = ftell(tar->fp);
     fseek(tar->fp, 0, SEEK_SET);
 }
 
+void sbtar_open(sbtar_t *tar, const char *filename) {
+    _open_tar(tar, filename, "rb+");
+}
+
+void sbtar_load(sbtar_t *tar, const char *filename) {
+    _open_tar(tar, filename, "rb");
+
+#ifdef SBTAR_USE_MMAP
+    /* fileno isn't ISO C, so map through a separate descriptor */
+    int fd = tar->size > 0 ? open(filename, O_RDONLY) : -1;
+    if (fd >= 0) {
+        void *map = mmap(NULL, tar->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) tar->map = map;
+        close(fd);
+    }
+#endif
+
+    _index_build(tar);
+    sbtar_rewind(tar);
+}
+
 void sbtar_new(sbtar_t *tar, const char* filename) {
     SBTAR_ASSERT(tar != NULL);
     tar->fp = fopen(filename, "wb+");
@@ -208,6 +373,7 @@ void sbtar_new(sbtar_t *tar, const char* filename) {
     }
     posix_header_t p;
     tar->offset = 0;
+    _reset_index(tar);
     memset(&p, 0, sizeof(p));
     fwrite(&p, 1, SBTAR_BLOCK_SIZE, tar->fp);
     fwrite(&p, 1, SBTAR_BLOCK_SIZE, tar->fp);
@@ -222,6 +388,13 @@ void sbtar_close(sbtar_t *tar) {
 
     fclose(tar->fp);
     tar->offset = 0;
+
+#ifdef SBTAR_USE_MMAP
+    if (tar->map) munmap((void*)tar->map, tar->size);
+#endif
+    SBTAR_FREE(tar->entries);
+    SBTAR_FREE(tar->slots);
+    _reset_index(tar);
 }
 
 int sbtar_next(sbtar_t *tar) {
@@ -234,7 +407,7 @@ int sbtar_next(sbtar_t *tar) {
     /*printf("%d\n", h.type + 1);*/
     int type = h.type;
     if (type < 0 || (tar->offset + next >= tar->size)) return 0;
-    if (h.size != 0) next += SBTAR_BLOCK_SIZE;
+    next = _entry_span(h.size);
     sbtar_seek(tar, tar->offset + next);
 
     return 1;
@@ -282,15 +455,7 @@ void sbtar_header(sbtar_t *tar, sbtar_header_t *header) {
 
     posix_header_t posix;
     fread(&posix, 1, SBTAR_BLOCK_SIZE, tar->fp);
-    strcpy(h->name, posix.name);
-    strcpy(h->linkname, posix.linkname);
-    h->size = oct2int(posix.size, SBTAR_SZ_SIZE-1);
-    h->mtime = oct2int(posix.mtime, SBTAR_MTIME_SIZE-1);
-    h->type = posix.typeflag - '0';
-    h->mode = oct2int(posix.mode, 7);
-    h->chksum = oct2int(posix.chksum, 7);
-    strcpy(h->uname, posix.uname);
-    strcpy(h->gname, posix.gname);
+    _parse_header(&posix, h);
 
     fseek(tar->fp, tar->offset, SEEK_SET);
 }
@@ -313,10 +478,43 @@ void sbtar_data(sbtar_t *tar, void *ptr, unsigned size) {
     fseek(tar->fp, tar->offset, SEEK_SET);
 }
 
+const sbtar_entry_t* sbtar_entry(sbtar_t *tar, const char *filename) {
+    SBTAR_ASSERT(tar != NULL);
+    SBTAR_ASSERT(filename != NULL);
+    if (!tar->slots) return NULL;
+
+    unsigned hash = _hash_name(filename);
+    unsigned slot = hash & tar->mask;
+    while (tar->slots[slot]) {
+        const sbtar_entry_t *e = tar->entries + tar->slots[slot] - 1;
+        if (e->hash == hash && !strcmp(e->name, filename)) return e;
+        slot = (slot + 1) & tar->mask;
+    }
+    return NULL;
+}
+
+const char* sbtar_view(sbtar_t *tar, const char *filename, unsigned *size) {
+    SBTAR_ASSERT(tar != NULL);
+    SBTAR_ASSERT(filename != NULL);
+    if (!tar->map) return NULL;
+
+    const sbtar_entry_t *e = sbtar_entry(tar, filename);
+    if (!e) return NULL;
+    if (size) *size = e->size;
+    return tar->map + e->offset + SBTAR_BLOCK_SIZE;
+}
+
 int sbtar_find(sbtar_t *tar, const char *filename) {
     SBTAR_ASSERT(tar != NULL);
     SBTAR_ASSERT(filename != NULL);
 
+    if (tar->slots) {
+        const sbtar_entry_t *e = sbtar_entry(tar, filename);
+        if (!e) return 0;
+        sbtar_seek(tar, e->offset);
+        return 1;
+    }
+
     sbtar_rewind(tar);
 
     sbtar_header_t h;
@@ -333,6 +531,17 @@ int sbtar_find(sbtar_t *tar, const char *filename) {
 const char* sbtar_read(sbtar_t *tar, const char *filename) {
     SBTAR_ASSERT(tar != NULL);
     SBTAR_ASSERT(filename != NULL);
+
+    if (tar->slots) {
+        const sbtar_entry_t *e = sbtar_entry(tar, filename);
+        if (!e) return NULL;
+        char *out = SBTAR_MALLOC(e->size + 1);
+        _read_at(tar, e->offset + SBTAR_BLOCK_SIZE, out, e->size);
+        out[e->size] = '\0';
+        sbtar_seek(tar, e->offset);
+        return out;
+    }
+
     if (!sbtar_find(tar, filename)) return NULL;
 
     sbtar_header_t h;
@@ -352,6 +561,7 @@ const char* sbtar_read(sbtar_t *tar, const char *filename) {
 void sbtar_write(sbtar_t *tar, const char *filename, const char *text, unsigned size) {
     SBTAR_ASSERT(tar != NULL);
     SBTAR_ASSERT(filename != NULL);
+    SBTAR_ASSERT(tar->slots == NULL);
     if (sbtar_find(tar, filename)) return;
     sbtar_rewind(tar);
     while (sbtar_next(tar));
@@ -412,6 +622,7 @@ void sbtar_write(sbtar_t *tar, const char *filename, const char *text, unsigned
 void sbtar_write_dir(sbtar_t *tar, const char *dirname) {
     SBTAR_ASSERT(tar != NULL);
     SBTAR_ASSERT(dirname != NULL);
+    SBTAR_ASSERT(tar->slots == NULL);
     if (sbtar_find(tar, dirname)) return;
     sbtar_rewind(tar);
     while (sbtar_next(tar));